@@ -11,6 +11,8 @@ LIBS = `pkg-config --libs gtk+-2.0` -lX11 -lXext
 CPPFLAGS = -DVERSION=\"${VERSION}\"
 CFLAGS = -g -std=c99 -pedantic -Wall -Os -D_REENTRANT ${INCS} ${CPPFLAGS} `pkg-config --cflags gtk+-2.0`
 LDFLAGS = ${LIBS}
+# the tab tree core needs neither GTK nor X
+CORE_CFLAGS = -g -std=c99 -pedantic -Wall ${INCS}
 
 # compiler and linker
 CC = cc
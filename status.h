@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014 Stefan Mark <mark at unserver dot de>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Layout of the status file $XDG_RUNTIME_DIR/tabsterPID.status
+ *
+ * The file is written by tabster only. It has mode 0600: only the user
+ * running tabster may mmap() it, read-only. It is protected by a sequence
+ * lock: seq is odd while tabster writes, so a reader does
+ *
+ *   do {
+ *       s = __atomic_load_n(&st->seq, __ATOMIC_ACQUIRE);
+ *       if(s & 1) continue;
+ *       ... copy what you need ...
+ *       __atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *   } while(__atomic_load_n(&st->seq, __ATOMIC_RELAXED) != s);
+ *
+ * The file only grows. If size is bigger than the mapping of the reader,
+ * the reader has to map it again before following any offset.
+ */
+
+#ifndef TABSTER_STATUS_H
+#define TABSTER_STATUS_H
+
+#include <stdint.h>
+
+#define TABSTER_STATUS_MAGIC 0x54425354 // "TBST"
+#define TABSTER_STATUS_VERSION 1
+
+struct TabsterStatusTab_ {
+	int32_t pid;
+	int32_t page;       // notebook page of the tab
+	uint32_t depth;     // 1 for top level tabs
+	uint32_t title;     // offset of the NUL terminated title, 0 if none
+	uint32_t title_len;
+} typedef TabsterStatusTab;
+
+struct TabsterStatus_ {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq;       // odd while being written
+	uint32_t size;      // size of the file
+	int32_t current;    // index into tabs of the current tab, -1 if none
+	uint32_t count;     // number of tabs
+	uint32_t strings;   // offset of the title area
+	uint32_t reserved;
+	TabsterStatusTab tabs[]; // count tabs in tree order
+} typedef TabsterStatus;
+
+#endif
@@ -15,7 +15,7 @@
  * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#define _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,17 +23,38 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <gtk/gtk.h>
+#include <gdk/gdkx.h>
 #include <unistd.h>
 #include <glib.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "status.h"
+#include "tabtree.h"
+
+#define SPAWN_HISTOGRAM_SIZE 16 // log2 buckets of milliseconds
+#define SPAWN_TIMEOUT 10 // seconds until a client not embedding frees its slot
+#define BATCH_TIMEOUT 5 // seconds until a begin without commit is applied anyway
+#define BATCH_MAX_CMDS 256 // commands read from the fifo per tick
 
 struct ContainerData_ {
 	GtkWidget *socket;
 	int pid;
-	GtkTreeRowReference *row;
+	int node; // in tabster.tree
+	GtkTreeIter iter; // row in tabster.tabmodel, see view_insert()
+	gboolean expanded; // row state while its rows are rebuilt
 
-	gchar *restore_cmd;
-	gchar *title;
+	const gchar *restore_cmd; // interned, see strpool_ref()
+	const gchar *title; // interned, see strpool_ref()
+
+	Window plug; // X window of the embedded client, 0 if none
+	gboolean title_dirty;
+	gboolean title_from_fifo; // client sends tabtitle, ignore its window title
+
+	gint64 spawned; // monotonic time of spawn while waiting for the plug
+	guint spawn_timeout;
 } typedef ContainerData;
 
 struct Tabster_ {
@@ -45,7 +66,51 @@ struct Tabster_ {
     GtkTreeView *tabtree;
     GtkTreeStore *tabmodel;
 
-	GList *socket_list;
+	// tab order and hierarchy, the notebook and tree store follow it
+	TabTree tree;
+
+	// interned tab strings: string -> refcount
+	GHashTable *strpool;
+	gsize strpool_bytes;
+	gsize strpool_shared;
+	// scratch space for strings living only during one command, see scratch_split()
+	gchar scratch[2048];
+	gsize scratch_used;
+
+	// title tracking of embedded clients: plug XID -> ContainerData
+	GHashTable *plugs;
+	GSList *title_queue;
+	guint title_idle;
+	Atom atom_net_wm_name;
+	Atom atom_utf8_string;
+
+	// status page for status bars and scripts, see status.h
+	int statusfd;
+	gchar *statusfn;
+	TabsterStatus *status;
+	gsize status_size;
+	guint status_idle;
+
+	// spawn scheduling, see pump_spawns()
+	GList *spawn_queue;
+	guint spawns_inflight;
+	guint spawns_timed_out;
+	guint spawn_histogram[SPAWN_HISTOGRAM_SIZE];
+
+	// batched fifo commands, see batch_apply()
+	gboolean batching; // running fifo commands, their work is deferred
+	int batch_depth; // open begin commands
+	guint batch_timeout;
+	int dirty;
+	ContainerData *pending_page;
+	gint64 batch_start;
+	guint batch_cmds;
+	guint batches;
+	guint batches_cmds;
+	gint64 batches_time;
+	gint64 batches_max;
+	gint64 batch_last;
+	gint64 batch_last_apply;
 
 	int fifofd;
     char fifobuf[1024];
@@ -56,42 +121,91 @@ enum directions {
    STEP_PREV,
 };
 
+// work deferred until the end of a batch
+enum dirty {
+   DIRTY_SESSION = 1<<0,
+   DIRTY_SPAWNS = 1<<1,
+};
+
 static void die(const char *errstr, ...);
 
 static void setup_window();
 static gboolean checkfifo(gpointer data);
 static void parse_cmd();
+static gchar *scratch_split(const gchar *s, gchar **tail);
+static void print_stats();
+static void batch_begin();
+static void batch_end();
+static void batch_open();
+static void batch_close();
+static gboolean batch_timeout_cb(gpointer data);
+static void batch_apply();
+
+static const gchar *strpool_ref(const gchar *s);
+static void strpool_unref(const gchar *s);
 
 static ContainerData *new_socket_for_plug();
-static GtkTreeRowReference *new_tab_page(GtkWidget *socket, GtkTreeIter *parent);
+static void new_tab_page(ContainerData *cd, int parent);
+static void remove_tab_node(ContainerData *cd);
+static int move_tab_node(ContainerData *cd, int parent);
+static gint tree_page(int n);
+static void move_pages(ContainerData *cd, gint old);
+static void collect_sockets(int n, GPtrArray *sockets);
+static void view_insert(int n);
+static void view_insert_rows(int n, GtkTreeIter *parent, GtkTreeIter *sibling);
+static void view_save_expanded(int n);
+static void view_restore_expanded(int n);
+static void view_expand_parent(int n);
 static int spawn(gchar *cmd, int socket);
 static void spawn_new_tab(gchar *cmd, gboolean in_background, gboolean as_child);
-
-static ContainerData *get_cd_by(gconstpointer data, GCompareFunc func);
+static void queue_spawn(ContainerData *cd);
+static void pump_spawns();
+static GList *next_spawn();
+static void spawn_done(ContainerData *cd, gboolean embedded);
+static gboolean spawn_timeout_cb(gpointer data);
+
+static ContainerData *get_cd_by_page(gint page);
+static ContainerData *get_cd_by_pid(gint pid);
 static ContainerData *get_cd_by_iter(GtkTreeIter *iter);
 static void set_page(gint i);
+static gint current_page();
 static gint linear_step(int dir, gint page, gboolean turn_around);
-static gboolean get_iter_by_cd(ContainerData *cd, GtkTreeIter *iter);
 static void set_pid_tab_title(gint pid, gchar *title);
+static void set_cd_title(ContainerData *cd, const gchar *title);
+static gchar *read_plug_title(Window win);
+static void queue_title_update(ContainerData *cd);
+static gboolean flush_titles_cb(gpointer data);
 static void set_pid_tab_restore(gint pid, gchar *restore);
 static void close_nth(gint n);
+static void attach_nth(gint n);
 
 static void page_removed_cb(GtkNotebook *, GtkWidget *, guint, gpointer);
+static void page_switched_cb(GtkNotebook *, gpointer, guint, gpointer);
 static void row_clicked_cb(GtkTreeView *view, gpointer data);
+static void plug_added_cb(GtkSocket *socket, gpointer data);
+static gboolean plug_removed_cb(GtkSocket *socket, gpointer data);
+static GdkFilterReturn xevent_filter_cb(GdkXEvent *xevent, GdkEvent *event, gpointer data);
+static void title_cell_cb(GtkTreeViewColumn *, GtkCellRenderer *, GtkTreeModel *, GtkTreeIter *, gpointer);
 
-static gint by_pid(gconstpointer data, gconstpointer pid);
-static gint by_widget(gconstpointer data, gconstpointer pid);
-static gint by_path(gconstpointer data, gconstpointer path);
 static void save_session();
+static void save_tab_cb(TabTree *t, int n, const char *path, void *data);
+
+static void open_status(int pid);
+static void close_status();
+static void status_changed();
+static gboolean publish_status_cb(gpointer data);
+static void publish_status();
 
 
 #define XALLOC(target, type, size) if((target = calloc(sizeof(type), size)) == NULL) die("Error: calloc failed\n")
 
-#define CURPAGE gtk_notebook_get_current_page(GTK_NOTEBOOK(tabster.notebook))
-#define NTH_PAGE(n) gtk_notebook_get_nth_page(GTK_NOTEBOOK(tabster.notebook), n), by_widget
+#define CURPAGE current_page()
+#define PAGE_OF(cd) gtk_notebook_page_num(GTK_NOTEBOOK(tabster.notebook), (cd)->socket)
+#define TAB(n) ((ContainerData*)TABTREE_DATA(&tabster.tree, n))
 
 Tabster tabster;
 static gint tree_pane_width = 200;
+static gint max_spawns = 4;
 
 void die(const char *errstr, ...) {
 	va_list ap;
@@ -113,17 +227,18 @@ void setup_window() {
 	// style
     gtk_widget_set_can_focus(GTK_WIDGET(tabster.tabtree), FALSE);
     gtk_tree_view_set_headers_visible(tabster.tabtree, FALSE);
-    // * add tree store
-    tabster.tabmodel = gtk_tree_store_new(1, G_TYPE_STRING);
+    // * add tree store (rows point to their ContainerData, title is not copied)
+    tabster.tabmodel = gtk_tree_store_new(1, G_TYPE_POINTER);
     gtk_tree_view_set_model(tabster.tabtree, GTK_TREE_MODEL(tabster.tabmodel));
     // * add cell renderer
     trenderer = gtk_cell_renderer_text_new();
-    gtk_tree_view_insert_column_with_attributes(tabster.tabtree, -1, "", trenderer, "text", 0, NULL);
+    gtk_tree_view_insert_column_with_data_func(tabster.tabtree, -1, "", trenderer, title_cell_cb, NULL, NULL);
 
     // ** create notebook
 	tabster.notebook = gtk_notebook_new();
 	// connect signals
 	g_signal_connect(tabster.notebook, "page-removed", G_CALLBACK(page_removed_cb), (gpointer)&tabster);
+	g_signal_connect_after(tabster.notebook, "switch-page", G_CALLBACK(page_switched_cb), NULL);
 	// style
 	gtk_notebook_popup_enable(GTK_NOTEBOOK(tabster.notebook));
 	gtk_notebook_set_scrollable(GTK_NOTEBOOK(tabster.notebook), TRUE);
@@ -149,40 +264,61 @@ void setup_window() {
 	gtk_container_add(GTK_CONTAINER(tabster.window), GTK_WIDGET(tabster.pane));
 	
 	gtk_widget_show_all(tabster.window);
+
+	// ** title tracking for plugs not talking to the fifo
+	tabster.plugs = g_hash_table_new(g_direct_hash, g_direct_equal); // FREE main/tabster.plugs
+	tabster.atom_net_wm_name = gdk_x11_get_xatom_by_name("_NET_WM_NAME");
+	tabster.atom_utf8_string = gdk_x11_get_xatom_by_name("UTF8_STRING");
+	// one filter for all sockets, dispatched by window id
+	gdk_window_add_filter(NULL, xevent_filter_cb, NULL);
 }
 
 gboolean checkfifo(gpointer data) {
-    int r, c = 0;
+    int r, c = 0, cmds = 0;
 
-    // read from fifo
-    for(;;) {
+    // read from fifo until it is empty, all of it is one batch
+    while(cmds<BATCH_MAX_CMDS) {
     	r = read(tabster.fifofd, tabster.fifobuf + c, 1);
-    	if(!r || tabster.fifobuf[c]=='\n' || c>1022)
+    	if(r>0 && tabster.fifobuf[c]!='\n' && c<1023) {
+    		c++;
+    		continue;
+    	}
+
+	    // do something
+    	if(c) {
+			// terminate command
+			tabster.fifobuf[c] = '\0';
+			if(!cmds++)
+				batch_begin();
+	    	parse_cmd();
+	    	c = 0;
+    	}
+    	if(r<=0)
     		break;
-    	c++;
     }
 
-    // do something
-    if(c) {
-		// terminate command
-		tabster.fifobuf[c] = '\0';
-    	parse_cmd();
-    }
+    if(cmds)
+    	batch_end();
 
     return TRUE;
 }
 
 void parse_cmd() {
 	gint n;
-	gchar** cmd;
-    gchar** parts;
+	gchar *cmd[2];
+    gchar *parts[2];
 
     // split command line at first space symbol
-    cmd = g_strsplit(tabster.fifobuf, " ", 2); // FREE parse_cmd/cmd
-	g_strstrip(cmd[0]);
-    if(cmd[1]) g_strstrip(cmd[1]);
+    cmd[0] = scratch_split(tabster.fifobuf, &cmd[1]);
 
     printf("-%s-\n", tabster.fifobuf);
+    tabster.batch_cmds++;
+
+    // batches
+    if(!g_strcmp0(cmd[0], "begin"))
+    	batch_open();
+    if(!g_strcmp0(cmd[0], "commit"))
+    	batch_close();
 	    
     // new tab
     if(!g_strcmp0(cmd[0], "new"))
@@ -194,40 +330,36 @@ void parse_cmd() {
     if(!g_strcmp0(cmd[0], "bcnew"))
     	spawn_new_tab(cmd[1], TRUE, TRUE);
 
-    if(!g_strcmp0(cmd[0], "add")) {
-        parts = g_strsplit(cmd[1], " ", 2); // FREE parse_cmd/parts
+    if(!g_strcmp0(cmd[0], "add") && cmd[1]) {
+        parts[0] = scratch_split(cmd[1], &parts[1]);
 
-	    GtkTreePath *path;
-	    GtkTreeIter piter;
+	    gchar *sp;
+	    int parent = TABTREE_NONE;
 	    ContainerData *cd;
 
-	    path = gtk_tree_path_new_from_string(parts[0]); // FREE ?/path
-		cd = new_socket_for_plug();
-	    if(gtk_tree_path_get_depth(path)>1) {
-	    	gtk_tree_path_up(path);
-		   	gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), &piter, path);
-			cd->row = new_tab_page(GTK_WIDGET(cd->socket), &piter);
-	    } else {
-			cd->row = new_tab_page(GTK_WIDGET(cd->socket), NULL);
+	    // parent is the path without its last index
+	    sp = strrchr(parts[0], ':');
+	    if(sp) {
+	    	*sp = '\0';
+	    	parent = tabtree_lookup(&tabster.tree, parts[0]);
 	    }
-	    gtk_tree_path_free(path); // FREED ?/path
-		cd->pid = spawn(parts[1], gtk_socket_get_id(GTK_SOCKET(cd->socket)));
-		cd->restore_cmd = g_strdup(parts[1]); // FREE /cd->restore_cmd
-		tabster.socket_list = g_list_append(tabster.socket_list, cd); // FREE /tabster.socket_list[]
-
-		g_strfreev(parts); // FREED parse_cmd/parts
+		cd = new_socket_for_plug();
+		cd->restore_cmd = strpool_ref(parts[1]); // FREE /cd->restore_cmd
+		new_tab_page(cd, parent);
+		if(cd->restore_cmd)
+			queue_spawn(cd);
+		status_changed();
     }
 
     // set tab attributes
-    if(!g_strcmp0(cmd[0], "tabtitle")) {
-        parts = g_strsplit(cmd[1], " ", 2); // FREE parse_cmd/parts
+    if(!g_strcmp0(cmd[0], "tabtitle") && cmd[1]) {
+        parts[0] = scratch_split(cmd[1], &parts[1]);
         set_pid_tab_title(atoi(parts[0]), parts[1]);
-		g_strfreev(parts); // FREED parse_cmd/parts
     }
-    if(!g_strcmp0(cmd[0], "restore_cmd")) {
-        parts = g_strsplit(cmd[1], " ", 2); // FREE parse_cmd/parts
-        set_pid_tab_restore(atoi(parts[0]), parts[1]);
-		g_strfreev(parts); // FREED parse_cmd/parts
+    if(!g_strcmp0(cmd[0], "restore_cmd") && cmd[1]) {
+        parts[0] = scratch_split(cmd[1], &parts[1]);
+        if(parts[1])
+	        set_pid_tab_restore(atoi(parts[0]), parts[1]);
     }
 
     // tab selection
@@ -235,7 +367,7 @@ void parse_cmd() {
     	set_page(linear_step(STEP_PREV, CURPAGE, TRUE));
     if(!g_strcmp0(cmd[0], "next"))
     	set_page(linear_step(STEP_NEXT, CURPAGE, TRUE));
-    if(!g_strcmp0(cmd[0], "goto")) {
+    if(!g_strcmp0(cmd[0], "goto") && cmd[1]) {
     	n = atoi(cmd[1]);
     	set_page(n);
     }
@@ -254,8 +386,8 @@ void parse_cmd() {
     	// gint p = atoi(cmd[1]);
     	// gtk_notebook_reorder_child(GTK_NOTEBOOK(tabster.notebook), gtk_notebook_get_nth_page(GTK_NOTEBOOK(tabster.notebook), gtk_notebook_get_current_page(GTK_NOTEBOOK(tabster.notebook))), p);
     }
-    if(!g_strcmp0(cmd[0], "attach")) {	
-    	// TODO
+    if(!g_strcmp0(cmd[0], "attach") && cmd[1]) {
+    	attach_nth(atoi(cmd[1]));
     }
 
     // interface stuff
@@ -266,52 +398,355 @@ void parse_cmd() {
     	gtk_paned_set_position(tabster.pane, tree_pane_width);
     }
 
-	g_strfreev(cmd); // FREED parse_cmd/cmd
+    // diagnostics
+    if(!g_strcmp0(cmd[0], "stats")) {
+    	print_stats();
+    }
+
+	tabster.scratch_used = 0; // FREED parse_cmd/cmd, parse_cmd/parts
 	*tabster.fifobuf = '\0';
 }
 
+gchar *scratch_split(const gchar *s, gchar **tail) {
+	gchar *head, *sp;
+	gsize len;
+
+	// bump allocate from the scratch buffer, reset after each command. A
+	// command splits its line once and one argument once, so two lines fit
+	len = strlen(s) + 1;
+	if(len>sizeof(tabster.scratch) - tabster.scratch_used)
+		die("Error: scratch space exhausted\n");
+	head = memcpy(tabster.scratch + tabster.scratch_used, s, len); // FREE parse_cmd/scratch
+	tabster.scratch_used += len;
+	sp = strchr(head, ' ');
+	if(sp) {
+		*sp = '\0';
+		*tail = g_strstrip(sp + 1);
+	} else {
+		*tail = NULL;
+	}
+
+	return g_strstrip(head);
+}
+
+void print_stats() {
+	guint b;
+	guint tabs = tabster.tree.count;
+
+	printf("tabs: %u, %lu bytes of tab slots, %lu bytes of tree nodes\n", tabs, (unsigned long)(tabs * sizeof(ContainerData)),
+		(unsigned long)(tabster.tree.size * sizeof(TabNode)));
+	printf("strings: %u interned, %lu bytes, %lu bytes shared\n", g_hash_table_size(tabster.strpool),
+		(unsigned long)tabster.strpool_bytes, (unsigned long)tabster.strpool_shared);
+	printf("spawns: %u in flight, %u queued, limit %d, %u timed out\n", tabster.spawns_inflight,
+		g_list_length(tabster.spawn_queue), max_spawns, tabster.spawns_timed_out);
+	printf("batches: %u, %u commands, %lu us total, %lu us max, last %lu us (%lu us applying)\n", tabster.batches,
+		tabster.batches_cmds, (unsigned long)tabster.batches_time, (unsigned long)tabster.batches_max,
+		(unsigned long)tabster.batch_last, (unsigned long)tabster.batch_last_apply);
+	printf("spawn to embed:\n");
+	for(b = 0; b<SPAWN_HISTOGRAM_SIZE; b++) {
+		if(!tabster.spawn_histogram[b])
+			continue;
+		if(b==SPAWN_HISTOGRAM_SIZE - 1)
+			printf("  >= %6ums %u\n", 1u<<(b - 1), tabster.spawn_histogram[b]);
+		else
+			printf("  <  %6ums %u\n", 1u<<b, tabster.spawn_histogram[b]);
+	}
+	fflush(stdout);
+}
+
+// commands read from the fifo at once, or between begin and commit, are one batch
+void batch_begin() {
+	if(!tabster.batch_depth) {
+		tabster.batch_start = g_get_monotonic_time();
+		tabster.batch_cmds = 0;
+	}
+	tabster.batching = TRUE;
+}
+
+void batch_end() {
+	tabster.batching = FALSE;
+	if(!tabster.batch_depth)
+		batch_apply();
+}
+
+void batch_open() {
+	if(!tabster.batch_depth++)
+		tabster.batch_timeout = g_timeout_add_seconds(BATCH_TIMEOUT, batch_timeout_cb, NULL);
+}
+
+void batch_close() {
+	// a stray commit must not end the batch of the current read
+	if(!tabster.batch_depth || --tabster.batch_depth)
+		return;
+	g_source_remove(tabster.batch_timeout);
+	tabster.batch_timeout = 0;
+}
+
+// the script went away without commit
+gboolean batch_timeout_cb(gpointer data) {
+	fprintf(stderr, "batch: no commit after %d seconds\n", BATCH_TIMEOUT);
+	tabster.batch_depth = 0;
+	tabster.batch_timeout = 0;
+	batch_apply();
+
+	return FALSE;
+}
+
+// do what the commands of the batch left undone, in this order
+void batch_apply() {
+	ContainerData *cd;
+	gint64 start;
+
+	start = g_get_monotonic_time();
+	if(tabster.pending_page) {
+		cd = tabster.pending_page;
+		tabster.pending_page = NULL;
+		set_page(PAGE_OF(cd));
+	}
+	if(tabster.dirty & DIRTY_SPAWNS)
+		pump_spawns();
+	if(tabster.dirty & DIRTY_SESSION)
+		save_session();
+	tabster.dirty = 0;
+
+	tabster.batch_last_apply = g_get_monotonic_time() - start;
+	tabster.batch_last = g_get_monotonic_time() - tabster.batch_start;
+	tabster.batches++;
+	tabster.batches_cmds += tabster.batch_cmds;
+	tabster.batches_time += tabster.batch_last;
+	if(tabster.batch_last>tabster.batches_max)
+		tabster.batches_max = tabster.batch_last;
+}
+
+const gchar *strpool_ref(const gchar *s) {
+	gpointer key, count;
+	gsize len;
+
+	if(!s)
+		return NULL;
+
+	len = strlen(s) + 1;
+	if(g_hash_table_lookup_extended(tabster.strpool, s, &key, &count)) {
+		g_hash_table_insert(tabster.strpool, key, GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+		tabster.strpool_shared += len;
+		return key;
+	}
+
+	key = g_strdup(s); // FREE strpool_unref/key
+	g_hash_table_insert(tabster.strpool, key, GUINT_TO_POINTER(1));
+	tabster.strpool_bytes += len;
+	return key;
+}
+
+void strpool_unref(const gchar *s) {
+	gpointer key, count;
+	gsize len;
+
+	if(!s || !g_hash_table_lookup_extended(tabster.strpool, s, &key, &count))
+		return;
+
+	len = strlen(s) + 1;
+	if(GPOINTER_TO_UINT(count) > 1) {
+		g_hash_table_insert(tabster.strpool, key, GUINT_TO_POINTER(GPOINTER_TO_UINT(count) - 1));
+		tabster.strpool_shared -= len;
+	} else {
+		g_hash_table_remove(tabster.strpool, key);
+		tabster.strpool_bytes -= len;
+		g_free(key); // FREED strpool_unref/key
+	}
+}
+
 ContainerData *new_socket_for_plug() {
 	ContainerData *cd;
 
-	XALLOC(cd, ContainerData, 1); // FREE /cd
+	cd = g_slice_new0(ContainerData); // FREE /cd
 	cd->socket = gtk_socket_new(); // FREE /cd->socket
+	cd->node = TABTREE_NONE;
+	g_object_set_data(G_OBJECT(cd->socket), "cd", cd);
+	g_signal_connect(cd->socket, "plug-added", G_CALLBACK(plug_added_cb), cd);
+	g_signal_connect(cd->socket, "plug-removed", G_CALLBACK(plug_removed_cb), cd);
 
 	return cd;
 }
 
-GtkTreeRowReference *new_tab_page(GtkWidget *socket, GtkTreeIter *piter) {
-    GtkTreeIter iter;//, *piter;
-	GtkTreePath *p;
+void new_tab_page(ContainerData *cd, int parent) {
+	cd->node = tabtree_insert(&tabster.tree, parent, TABTREE_NONE, cd);
+	if(cd->node==TABTREE_NONE)
+		die("Error: tabtree_insert failed\n");
 
-	gtk_widget_show(socket);
-	gtk_notebook_append_page(GTK_NOTEBOOK(tabster.notebook), socket, NULL);
+	// the notebook keeps the pre-order of the tree
+	gtk_widget_show(cd->socket);
+	gtk_notebook_insert_page(GTK_NOTEBOOK(tabster.notebook), cd->socket, NULL, tree_page(cd->node));
 
-    // append new row
-    gtk_tree_store_append(GTK_TREE_STORE(tabster.tabmodel), &iter, piter);
+	g_signal_handlers_block_by_func(tabster.tabtree, row_clicked_cb, NULL);
+	view_insert(cd->node);
+	view_expand_parent(cd->node);
+	g_signal_handlers_unblock_by_func(tabster.tabtree, row_clicked_cb, NULL);
+}
 
-    if(piter) {
-	    p = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), piter); // FREE new_tab_page/p
-    	gtk_tree_view_expand_row(tabster.tabtree, p, FALSE);
-		gtk_tree_path_free(p); // FREED new_tab_page/p
-    }
+// take cd out of the tree, its children move up into its place
+void remove_tab_node(ContainerData *cd) {
+	int c, first, last;
+
+	first = TABTREE_FIRST_CHILD(&tabster.tree, cd->node);
+	last = TABTREE_LAST_CHILD(&tabster.tree, cd->node);
+	for(c = first; c!=TABTREE_NONE; c = TABTREE_NEXT_SIBLING(&tabster.tree, c))
+		view_save_expanded(c);
+	tabtree_remove(&tabster.tree, cd->node);
+
+	// the pages are in order already, only the child rows move up, last first
+	// so each one goes before a row which is in place already
+	g_signal_handlers_block_by_func(tabster.tabtree, row_clicked_cb, NULL);
+	for(c = last; c!=TABTREE_NONE; c = c==first ? TABTREE_NONE : TABTREE_PREV_SIBLING(&tabster.tree, c)) {
+		view_insert(c);
+		view_restore_expanded(c);
+	}
+	gtk_tree_store_remove(tabster.tabmodel, &cd->iter);
+	g_signal_handlers_unblock_by_func(tabster.tabtree, row_clicked_cb, NULL);
+	cd->node = TABTREE_NONE;
+}
+
+// make cd the last child of parent, along with its subtree
+int move_tab_node(ContainerData *cd, int parent) {
+	GtkTreeIter old;
+	gint page;
+
+	page = PAGE_OF(cd);
+	if(tabtree_reparent(&tabster.tree, cd->node, parent, TABTREE_NONE))
+		return -1;
+
+	g_signal_handlers_block_by_func(tabster.tabtree, row_clicked_cb, NULL);
+	view_save_expanded(cd->node);
+	old = cd->iter;
+	view_insert(cd->node);
+	gtk_tree_store_remove(tabster.tabmodel, &old);
+	view_restore_expanded(cd->node);
+	view_expand_parent(cd->node);
+	g_signal_handlers_unblock_by_func(tabster.tabtree, row_clicked_cb, NULL);
+
+	move_pages(cd, page);
+	return 0;
+}
+
+// notebook page of node n, from the page of the node before it in pre-order
+gint tree_page(int n) {
+	n = tabtree_prev(&tabster.tree, n);
+	return n==TABTREE_NONE ? 0 : PAGE_OF(TAB(n)) + 1;
+}
+
+// the pages of the subtree of cd, starting at old, go where the tree has them now
+void move_pages(ContainerData *cd, gint old) {
+	GPtrArray *sockets;
+	gint p, prev;
+	guint i;
+
+	sockets = g_ptr_array_new(); // FREE move_pages/sockets
+	collect_sockets(cd->node, sockets);
+
+	// the node before cd is outside of the subtree and still on its old page
+	prev = tabtree_prev(&tabster.tree, cd->node);
+	if(prev==TABTREE_NONE)
+		p = 0;
+	else if((p = PAGE_OF(TAB(prev)))<old)
+		p++;
+	else
+		p -= sockets->len - 1;
 
-    p = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &iter); // FREE new_tab_page/p
+	// move the page nearest to its place first, so the others are not shifted
+	if(p<old)
+		for(i = 0; i<sockets->len; i++)
+			gtk_notebook_reorder_child(GTK_NOTEBOOK(tabster.notebook), g_ptr_array_index(sockets, i), p + i);
+	else if(p>old)
+		for(i = sockets->len; i>0; i--)
+			gtk_notebook_reorder_child(GTK_NOTEBOOK(tabster.notebook), g_ptr_array_index(sockets, i - 1), p + i - 1);
+
+	g_ptr_array_free(sockets, TRUE); // FREED move_pages/sockets
+}
+
+void collect_sockets(int n, GPtrArray *sockets) {
+	int c;
+
+	g_ptr_array_add(sockets, TAB(n)->socket);
+	for(c = TABTREE_FIRST_CHILD(&tabster.tree, n); c!=TABTREE_NONE; c = TABTREE_NEXT_SIBLING(&tabster.tree, c))
+		collect_sockets(c, sockets);
+}
+
+// add rows for n and its subtree where tabster.tree has n, the neighbours need rows
+void view_insert(int n) {
+	int p, s;
+
+	p = TABTREE_PARENT(&tabster.tree, n);
+	s = TABTREE_NEXT_SIBLING(&tabster.tree, n);
+	view_insert_rows(n, p!=TABTREE_NONE ? &TAB(p)->iter : NULL, s!=TABTREE_NONE ? &TAB(s)->iter : NULL);
+}
 
-    GtkTreeRowReference *ref = gtk_tree_row_reference_new(GTK_TREE_MODEL(tabster.tabmodel), p); // FREE /ref
-	gtk_tree_path_free(p); // FREED new_tab_page/p
+void view_insert_rows(int n, GtkTreeIter *parent, GtkTreeIter *sibling) {
+	ContainerData *cd = TAB(n);
+	int c;
 
-    return ref;
+	gtk_tree_store_insert_before(tabster.tabmodel, &cd->iter, parent, sibling);
+	gtk_tree_store_set(tabster.tabmodel, &cd->iter, 0, cd, -1);
+	for(c = TABTREE_FIRST_CHILD(&tabster.tree, n); c!=TABTREE_NONE; c = TABTREE_NEXT_SIBLING(&tabster.tree, c))
+		view_insert_rows(c, &cd->iter, NULL);
+}
+
+// remember which rows of the subtree of n are expanded
+void view_save_expanded(int n) {
+	GtkTreePath *path;
+	int c;
+
+	c = TABTREE_FIRST_CHILD(&tabster.tree, n);
+	if(c==TABTREE_NONE)
+		return;
+
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &TAB(n)->iter); // FREE view_save_expanded/path
+	TAB(n)->expanded = gtk_tree_view_row_expanded(tabster.tabtree, path);
+	gtk_tree_path_free(path); // FREED view_save_expanded/path
+
+	for(; c!=TABTREE_NONE; c = TABTREE_NEXT_SIBLING(&tabster.tree, c))
+		view_save_expanded(c);
+}
+
+// expand the rows view_save_expanded found expanded, parents first
+void view_restore_expanded(int n) {
+	GtkTreePath *path;
+	int c;
+
+	c = TABTREE_FIRST_CHILD(&tabster.tree, n);
+	if(c==TABTREE_NONE || !TAB(n)->expanded)
+		return;
+
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &TAB(n)->iter); // FREE view_restore_expanded/path
+	gtk_tree_view_expand_row(tabster.tabtree, path, FALSE);
+	gtk_tree_path_free(path); // FREED view_restore_expanded/path
+
+	for(; c!=TABTREE_NONE; c = TABTREE_NEXT_SIBLING(&tabster.tree, c))
+		view_restore_expanded(c);
+}
+
+// show n, other rows keep their state
+void view_expand_parent(int n) {
+	GtkTreePath *path;
+
+	n = TABTREE_PARENT(&tabster.tree, n);
+	if(n==TABTREE_NONE)
+		return;
+
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &TAB(n)->iter); // FREE view_expand_parent/path
+	gtk_tree_view_expand_row(tabster.tabtree, path, FALSE);
+	gtk_tree_path_free(path); // FREED view_expand_parent/path
 }
 
 int spawn(gchar *cmd, int socket) {
 	gchar *xcmd = g_strdup_printf(cmd, socket); // FREE spwan/xcmd
     gint argc;
     gchar** argv = NULL;
-    int pid;
+    int pid = 0;
 
     g_shell_parse_argv(xcmd, &argc, &argv, NULL); // TODO does this need to be freed
     GSpawnFlags flags = (GSpawnFlags)(G_SPAWN_SEARCH_PATH );//TODO | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL
-    g_spawn_async(NULL, argv, NULL, flags, NULL, NULL, &pid, NULL);
+    if(!argv || !g_spawn_async(NULL, argv, NULL, flags, NULL, NULL, &pid, NULL))
+    	pid = 0;
 
     g_free(xcmd); // FREED spwan/xcmd
     g_strfreev(argv); // TODO: i guess thats not needed
@@ -321,164 +756,321 @@ int spawn(gchar *cmd, int socket) {
 
 void spawn_new_tab(gchar *cmd, gboolean in_background, gboolean as_child) {
 	ContainerData *new_cd, *cur_cd;
-	GtkTreePath *p;
-	GtkTreeIter *piter;
-
-	cur_cd = get_cd_by(NTH_PAGE(CURPAGE));
-	if(cur_cd)
-		p = gtk_tree_row_reference_get_path(cur_cd->row); // FREE spawn_new_tab/p
+	int parent;
+
+	// sibling or child of the current tab
+	cur_cd = get_cd_by_page(CURPAGE);
+	if(!cur_cd)
+		parent = TABTREE_NONE;
+	else if(as_child)
+		parent = cur_cd->node;
 	else
-		p = gtk_tree_path_new_from_indices(0, -1); // ...
-
-    if(!as_child) {
-    	// get parent for new tab
-    	if(gtk_tree_path_get_depth(p)>1) {
-    		gtk_tree_path_up(p);
-    		XALLOC(piter, GtkTreeIter, 1); // FREE spawn_new_tab/piter
-	        gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), piter, p);
-    	} else {
-    		piter = NULL;
-    	}
-	} else {
-		XALLOC(piter, GtkTreeIter, 1); // ...
-        gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), piter, p);    	
-    }
-    gtk_tree_path_free(p); // FREED spawn_new_tab/p
+		parent = TABTREE_PARENT(&tabster.tree, cur_cd->node);
 
-	new_cd = new_socket_for_plug();	    	
-	new_cd->row = new_tab_page(GTK_WIDGET(new_cd->socket), piter); // FREE /new_cd->row
-	new_cd->pid = spawn(cmd, gtk_socket_get_id(GTK_SOCKET(new_cd->socket))); // FREE /new_cd->pid
-	new_cd->restore_cmd = g_strdup(cmd); // FREE /new_cd->restore_cmd
+	new_cd = new_socket_for_plug();
+	new_cd->restore_cmd = strpool_ref(cmd); // FREE /new_cd->restore_cmd
+	new_tab_page(new_cd, parent);
 
-    free(piter); // FREED spawn_new_tab/piter
-
-	tabster.socket_list = g_list_append(tabster.socket_list, new_cd); // FREE /tabster.socket_list[]
 	if(!in_background)
-		set_page(g_list_length(tabster.socket_list) - 1);
+		set_page(PAGE_OF(new_cd));
+	// after set_page, so a foreground tab is spawned first
+	if(new_cd->restore_cmd)
+		queue_spawn(new_cd);
 
 	save_session();
+	status_changed();
+}
+
+void queue_spawn(ContainerData *cd) {
+	tabster.spawn_queue = g_list_append(tabster.spawn_queue, cd); // FREE pump_spawns/tabster.spawn_queue[]
+	pump_spawns();
+}
+
+void pump_spawns() {
+	GList *l;
+	ContainerData *cd;
+
+	// wait for the batch, so its visible tab goes first
+	if(tabster.batching) {
+		tabster.dirty |= DIRTY_SPAWNS;
+		return;
+	}
+
+	while(tabster.spawn_queue && (max_spawns<=0 || tabster.spawns_inflight<(guint)max_spawns)) {
+		l = next_spawn();
+		cd = (ContainerData*)l->data;
+		tabster.spawn_queue = g_list_delete_link(tabster.spawn_queue, l); // FREED pump_spawns/tabster.spawn_queue[]
+
+		cd->pid = spawn((gchar*)cd->restore_cmd, gtk_socket_get_id(GTK_SOCKET(cd->socket))); // FREE /cd->pid
+		if(!cd->pid)
+			continue;
+
+		// in flight until the plug shows up
+		cd->spawned = g_get_monotonic_time();
+		cd->spawn_timeout = g_timeout_add_seconds(SPAWN_TIMEOUT, spawn_timeout_cb, cd);
+		tabster.spawns_inflight++;
+		// the status page shows the pid now
+		status_changed();
+	}
+}
+
+GList *next_spawn() {
+	GList *l, *best = NULL;
+	ContainerData *cd, *cur;
+	int prev = TABTREE_NONE, next = TABTREE_NONE;
+	gint rank, best_rank = 3;
+
+	// the visible tab first, then its neighbours in the tree, then in order
+	cur = get_cd_by_page(CURPAGE);
+	if(cur) {
+		prev = tabtree_prev(&tabster.tree, cur->node);
+		next = tabtree_next(&tabster.tree, cur->node);
+	}
+
+	for(l = tabster.spawn_queue; l; l = l->next) {
+		cd = (ContainerData*)l->data;
+
+		if(cd==cur)
+			rank = 0;
+		else if(cd->node==prev || cd->node==next)
+			rank = 1;
+		else
+			rank = 2;
+
+		if(rank<best_rank) {
+			best = l;
+			best_rank = rank;
+			if(!rank)
+				break;
+		}
+	}
+
+	return best;
+}
+
+void spawn_done(ContainerData *cd, gboolean embedded) {
+	gint64 ms;
+	guint b;
+
+	if(!cd->spawned)
+		return;
+
+	if(embedded) {
+		ms = (g_get_monotonic_time() - cd->spawned) / 1000;
+		for(b = 0; b<SPAWN_HISTOGRAM_SIZE - 1 && ms>=(G_GINT64_CONSTANT(1)<<b); b++);
+		tabster.spawn_histogram[b]++;
+	}
+	if(cd->spawn_timeout)
+		g_source_remove(cd->spawn_timeout);
+	cd->spawn_timeout = 0;
+	cd->spawned = 0;
+	tabster.spawns_inflight--;
+
+	pump_spawns();
+}
+
+gboolean spawn_timeout_cb(gpointer data) {
+	ContainerData *cd = (ContainerData*)data;
+
+	// give up waiting, the slot goes to the next tab
+	cd->spawn_timeout = 0;
+	tabster.spawns_timed_out++;
+	spawn_done(cd, FALSE);
+
+	return FALSE;
+}
+
+ContainerData *get_cd_by_page(gint page) {
+	GtkWidget *socket;
+
+	if(page<0)
+		return NULL;
+	socket = gtk_notebook_get_nth_page(GTK_NOTEBOOK(tabster.notebook), page);
+	return socket ? (ContainerData*)g_object_get_data(G_OBJECT(socket), "cd") : NULL;
 }
 
-ContainerData *get_cd_by(gconstpointer data, GCompareFunc func) {
-    GList *l;
+ContainerData *get_cd_by_pid(gint pid) {
+	int n;
+	ContainerData *cd;
 
-    l = g_list_find_custom(tabster.socket_list, data, func);
-	return l ? (ContainerData*)l->data : NULL;
+	if(pid<=0)
+		return NULL;
+	for(n = tabtree_first(&tabster.tree); n!=TABTREE_NONE; n = tabtree_next(&tabster.tree, n)) {
+		cd = (ContainerData*)TABTREE_DATA(&tabster.tree, n);
+		if(cd->pid==pid)
+			return cd;
+	}
+	return NULL;
 }
 
 ContainerData *get_cd_by_iter(GtkTreeIter *iter) {
-    GtkTreePath *path;
     ContainerData *cd;
 
-	path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), iter); // FREE get_cd_by_iter/path
-	cd = get_cd_by(path, by_path);
-	gtk_tree_path_free(path); // FREED get_cd_by_iter/path
+	gtk_tree_model_get(GTK_TREE_MODEL(tabster.tabmodel), iter, 0, &cd, -1);
 	return cd;
 }
 
 void set_page(gint n) {
-    GtkTreeIter iter;
     ContainerData *cd;
 
     if(n<0)
     	return;
 
+    // only remember the tab, batch_apply selects it
+    if(tabster.batching) {
+    	tabster.pending_page = get_cd_by_page(n);
+    	return;
+    }
+    // the user chose, an open batch must not switch back later
+    tabster.pending_page = NULL;
+
     // select tab in notebook
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(tabster.notebook), n);
 
 	// select row in tree
-    cd = get_cd_by(NTH_PAGE(n));
+    cd = get_cd_by_page(n);
     if(cd) {
-    	get_iter_by_cd(cd, &iter);
     	GtkTreeSelection *sel = gtk_tree_view_get_selection(tabster.tabtree); // NO FREE NEEDED
-    	gtk_tree_selection_select_iter(sel, &iter);
+    	gtk_tree_selection_select_iter(sel, &cd->iter);
     }
 }
 
+// current page, including a selection still pending in a batch
+gint current_page() {
+	if(tabster.pending_page)
+		return PAGE_OF(tabster.pending_page);
+	return gtk_notebook_get_current_page(GTK_NOTEBOOK(tabster.notebook));
+}
+
 gint linear_step(int dir, gint page, gboolean turn_around) {
-    GtkTreeIter iter;
 	ContainerData *cd;
-	GtkTreePath *path;
-
-	cd = get_cd_by(NTH_PAGE(page));
-	if(cd) {
-		path = gtk_tree_row_reference_get_path(cd->row); // FREE linear_step/path
-		gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), &iter, path);
-
-		if(dir==STEP_NEXT) { // ** next
-			if(gtk_tree_model_iter_has_child(GTK_TREE_MODEL(tabster.tabmodel), &iter)) {
-				gtk_tree_path_down(path);
-			} else {
-				gtk_tree_path_next(path);
-				while(!gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), &iter, path) && gtk_tree_path_get_depth(path)>1 && gtk_tree_path_up(path))
-					gtk_tree_path_next(path);
-				if(!gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), &iter, path)) {
-					gtk_tree_path_free(path); // FREED linear_step/path
-					if(turn_around)
-						path = gtk_tree_path_new_from_indices(0, -1); // FREE linear_step/path
-					else
-						return -1;
-				}
-			}
-		} else if(dir==STEP_PREV) { // ** prev
-			if(gtk_tree_path_prev(path)) {
-				gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), &iter, path);
-				while(gtk_tree_model_iter_has_child(GTK_TREE_MODEL(tabster.tabmodel), &iter)) {
-					gint lc = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(tabster.tabmodel), &iter) - 1;
-					gtk_tree_path_append_index(path, lc);
-					gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), &iter, path);
-				}
-			} else {
-				if(gtk_tree_path_get_depth(path)>1) {
-					gtk_tree_path_up(path);
-				} else if(turn_around) {
-					gint lc = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(tabster.tabmodel), NULL) - 1;
-					gtk_tree_path_free(path); // FREED linear_step/path
-					path = gtk_tree_path_new_from_indices(lc, -1); // FREE linear_step/path
-				} else {
-					gtk_tree_path_free(path);
-					return -1;
-				}
-			}
-		}
-
-	    cd = get_cd_by(path, by_path);
-	    if(cd)
-	    	return gtk_notebook_page_num(GTK_NOTEBOOK(tabster.notebook), cd->socket);
-		gtk_tree_path_free(path); // FREED linear_step/path
+	int n;
+
+	cd = get_cd_by_page(page);
+	if(!cd)
+		return -1;
+
+	if(dir==STEP_NEXT) { // ** next
+		n = tabtree_next(&tabster.tree, cd->node);
+		if(n==TABTREE_NONE && turn_around)
+			n = tabtree_first(&tabster.tree);
+	} else { // ** prev
+		n = tabtree_prev(&tabster.tree, cd->node);
+		if(n==TABTREE_NONE && turn_around)
+			n = tabtree_last(&tabster.tree);
 	}
-	return -1;
-}
-
-gboolean get_iter_by_cd(ContainerData *cd, GtkTreeIter *iter) {
-    gboolean b;
-    GtkTreePath *p;
+	if(n==TABTREE_NONE)
+		return -1;
 
-	p = gtk_tree_row_reference_get_path(cd->row); // FREE get_iter_by_cd/p
-	b = gtk_tree_model_get_iter(GTK_TREE_MODEL(tabster.tabmodel), iter, p);
-	gtk_tree_path_free(p); // FREED get_iter_by_cd/p
-	return b;
+	return PAGE_OF((ContainerData*)TABTREE_DATA(&tabster.tree, n));
 }
 
 void set_pid_tab_title(gint pid, gchar *title) {
     ContainerData *cd;
-    GtkTreeIter iter;
 
-    cd = get_cd_by(&pid, by_pid);
+    cd = get_cd_by_pid(pid);
     if(cd) {
-		get_iter_by_cd(cd, &iter);
-		gtk_tree_store_set(GTK_TREE_STORE(tabster.tabmodel), &iter, 0, title, -1);
-		cd->title = g_strdup(title); // FREE /cd->title
+    	cd->title_from_fifo = TRUE;
+    	set_cd_title(cd, title);
     }
 }
 
+void set_cd_title(ContainerData *cd, const gchar *title) {
+    GtkTreePath *path;
+    const gchar *old;
+
+	old = cd->title;
+	cd->title = strpool_ref(title); // FREE /cd->title
+	strpool_unref(old); // FREED /cd->title
+
+	// the row only points to cd, tell the view to redraw it
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &cd->iter); // FREE set_cd_title/path
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(tabster.tabmodel), path, &cd->iter);
+	gtk_tree_path_free(path); // FREED set_cd_title/path
+
+	status_changed();
+}
+
+gchar *read_plug_title(Window win) {
+	Display *dpy = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+	Atom type;
+	int format;
+	unsigned long n, after;
+	unsigned char *data = NULL;
+	gchar *title = NULL;
+
+	// the plug may be gone already
+	gdk_error_trap_push();
+
+	// prefer _NET_WM_NAME, it is always UTF-8
+	if(XGetWindowProperty(dpy, win, tabster.atom_net_wm_name, 0, 1024, False, tabster.atom_utf8_string,
+			&type, &format, &n, &after, &data) == Success && data) {
+		if(type == tabster.atom_utf8_string && format == 8 && n)
+			title = g_strndup((gchar*)data, n); // FREE flush_titles_cb/title
+		XFree(data);
+		data = NULL;
+	}
+
+	// fall back to WM_NAME, which is Latin-1 if it is a STRING
+	if(!title && XGetWindowProperty(dpy, win, XA_WM_NAME, 0, 1024, False, AnyPropertyType,
+			&type, &format, &n, &after, &data) == Success && data) {
+		if(format == 8 && n) {
+			if(type == XA_STRING)
+				title = g_convert((gchar*)data, n, "UTF-8", "ISO-8859-1", NULL, NULL, NULL); // FREE flush_titles_cb/title
+			else if(g_utf8_validate((gchar*)data, n, NULL))
+				title = g_strndup((gchar*)data, n); // FREE flush_titles_cb/title
+		}
+		XFree(data);
+	}
+
+	gdk_error_trap_pop();
+	return title;
+}
+
+void queue_title_update(ContainerData *cd) {
+	if(cd->title_dirty || cd->title_from_fifo)
+		return;
+
+	cd->title_dirty = TRUE;
+	tabster.title_queue = g_slist_prepend(tabster.title_queue, cd); // FREE flush_titles_cb/tabster.title_queue
+	// read titles once per frame, no matter how many changes arrived
+	if(!tabster.title_idle)
+		tabster.title_idle = g_idle_add_full(GDK_PRIORITY_REDRAW, flush_titles_cb, NULL, NULL);
+}
+
+gboolean flush_titles_cb(gpointer data) {
+	GSList *l;
+	ContainerData *cd;
+	gchar *title;
+
+	for(l = tabster.title_queue; l; l = l->next) {
+		cd = (ContainerData*)l->data;
+		cd->title_dirty = FALSE;
+		if(!cd->plug || cd->title_from_fifo)
+			continue;
+		title = read_plug_title(cd->plug);
+		if(title) {
+			set_cd_title(cd, title);
+			g_free(title); // FREED flush_titles_cb/title
+		}
+	}
+
+	g_slist_free(tabster.title_queue); // FREED flush_titles_cb/tabster.title_queue
+	tabster.title_queue = NULL;
+	tabster.title_idle = 0;
+
+	return FALSE;
+}
+
 void set_pid_tab_restore(gint pid, gchar *restore) {
     ContainerData *cd;
-    cd = get_cd_by(&pid, by_pid);
+    const gchar *old;
+    cd = get_cd_by_pid(pid);
 
     if(cd) {
-		g_free(cd->restore_cmd);
-		cd->restore_cmd = g_strdup(restore); // FREE /cd->restore_cmd
+    	old = cd->restore_cmd;
+		cd->restore_cmd = strpool_ref(restore); // FREE /cd->restore_cmd
+		strpool_unref(old); // FREED /cd->restore_cmd
 
 		save_session();
     }
@@ -489,108 +1081,138 @@ void close_nth(gint n) {
     gtk_notebook_remove_page(GTK_NOTEBOOK(tabster.notebook), n);
 }
 
-void remove_row(GtkTreeIter *iter, GtkTreeIter *piter) {
-    int i;
-    ContainerData *cd;
-    GtkTreePath *path;//, *p, *npath;
-    GtkTreeIter citer, niter;
-
-    if(gtk_tree_model_iter_has_child(GTK_TREE_MODEL(tabster.tabmodel), iter)) {
-    	// one by one
-    	i = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(tabster.tabmodel), iter) - 1;
-    	for(;i>=0;i--) {
-    		gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(tabster.tabmodel), &citer, iter, i);
-			cd = get_cd_by_iter(&citer);
-			if(cd) {
-			    gtk_tree_store_append(GTK_TREE_STORE(tabster.tabmodel), &niter, piter);
-				gtk_tree_store_set(GTK_TREE_STORE(tabster.tabmodel), &niter, 0, cd->title, -1);
-	        	remove_row(&citer, &niter);
-				path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &niter); // FREE remove_row/path
-			    cd->row = gtk_tree_row_reference_new(GTK_TREE_MODEL(tabster.tabmodel), path);
-			    gtk_tree_path_free(path); // FREED remove_row/path
-			}
-    	}
-    	if(piter!=NULL) {
-			path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), piter); // FREE remove_row/path
-    		gtk_tree_view_expand_row(tabster.tabtree, path, FALSE);
-			gtk_tree_path_free(path); // FREED remove_row/path
-    	}
-    }
-	gtk_tree_store_remove(GTK_TREE_STORE(tabster.tabmodel), iter);
+void attach_nth(gint n) {
+	ContainerData *cd, *pcd;
+
+	// current tab becomes the last child of tab n
+	cd = get_cd_by_page(CURPAGE);
+	pcd = get_cd_by_page(n);
+	if(!cd || !pcd || move_tab_node(cd, pcd->node))
+		return;
+
+	set_page(PAGE_OF(cd));
+	save_session();
+	status_changed();
 }
 
 void page_removed_cb(GtkNotebook *nb, GtkWidget *widget, guint id, gpointer data) {
-	GtkTreeIter iter, piter;
-	GList *l;
 	ContainerData *cd;
 
-	l = g_list_find_custom(tabster.socket_list, widget, by_widget);
-	if(l) {
-		cd = (ContainerData*)l->data;
+	cd = (ContainerData*)g_object_get_data(G_OBJECT(widget), "cd");
+	if(cd) {
 
+		tabster.spawn_queue = g_list_remove(tabster.spawn_queue, cd);
 		g_spawn_close_pid(cd->pid); // FREED /cd->pid
-		g_free(cd->restore_cmd); // FREED /cd->resore_cmd
-		g_free(cd->title); // FREED /cd->title
-		tabster.socket_list = g_list_remove(tabster.socket_list, l->data); // FREED /tabster.socket_list[]
-
-	    // remove row from tree
-	    get_iter_by_cd(cd, &iter);	    
-	    if(gtk_tree_model_iter_parent(GTK_TREE_MODEL(tabster.tabmodel), &piter, &iter))
-	    	remove_row(&iter, &piter);
-	    else
-	    	remove_row(&iter, NULL);
+		if(cd->plug)
+			g_hash_table_remove(tabster.plugs, GUINT_TO_POINTER(cd->plug));
+		if(cd->title_dirty)
+			tabster.title_queue = g_slist_remove(tabster.title_queue, cd);
+		if(tabster.pending_page==cd)
+			tabster.pending_page = NULL;
+
+	    remove_tab_node(cd);
+	    // title_cell_cb may read them until the row is gone
+		strpool_unref(cd->restore_cmd); // FREED /cd->resore_cmd
+		strpool_unref(cd->title); // FREED /cd->title
+	    // the notebook may have switched, keep the selected row in line
+	    set_page(CURPAGE);
+
+		// frees the spawn slot, if still waiting for the plug
+		spawn_done(cd, FALSE);
 
 		// FREED /cd
-		g_free(cd);
+		g_slice_free(ContainerData, cd);
+		status_changed();
 
-		// quit if list is empty
-		if(!g_list_length(tabster.socket_list)) {
-			g_list_free(tabster.socket_list);
+		// quit if tree is empty
+		if(!tabster.tree.count)
 			gtk_main_quit();
-		}
 	}
 }
 
+void page_switched_cb(GtkNotebook *nb, gpointer page, guint n, gpointer data) {
+	status_changed();
+}
+
 void row_clicked_cb(GtkTreeView *view, gpointer data) {
     GtkTreeIter iter;
     GtkTreeSelection *sel;
-    GtkTreePath *path;//, *p;
     ContainerData *cd;
 
     sel = gtk_tree_view_get_selection(tabster.tabtree);
-    gtk_tree_selection_get_selected(sel, NULL, &iter);
-    path = gtk_tree_model_get_path(GTK_TREE_MODEL(tabster.tabmodel), &iter); // FREE row_clicked_cb/path
+    if(!gtk_tree_selection_get_selected(sel, NULL, &iter))
+    	return;
 
-    cd = get_cd_by(path, by_path);
+    cd = get_cd_by_iter(&iter);
     if(cd)
     	set_page(gtk_notebook_page_num(GTK_NOTEBOOK(tabster.notebook), cd->socket));
+}
+
+void plug_added_cb(GtkSocket *socket, gpointer data) {
+    ContainerData *cd = (ContainerData*)data;
+    GdkWindow *win;
+
+    win = gtk_socket_get_plug_window(socket);
+    if(!win)
+    	return;
+
+    // make sure title changes of the client reach xevent_filter_cb
+    gdk_window_set_events(win, gdk_window_get_events(win) | GDK_PROPERTY_CHANGE_MASK);
+
+    if(cd->plug)
+    	g_hash_table_remove(tabster.plugs, GUINT_TO_POINTER(cd->plug));
+    cd->plug = GDK_WINDOW_XID(win);
+    g_hash_table_insert(tabster.plugs, GUINT_TO_POINTER(cd->plug), cd);
 
-    gtk_tree_path_free(path); // FREE row_clicked_cb/path
+    spawn_done(cd, TRUE);
+
+    // pick up the title the client already has
+    queue_title_update(cd);
 }
 
-gint by_pid(gconstpointer data, gconstpointer pid) {
-	return ((ContainerData*)data)->pid==*(int*)pid ? 0 : 1;
+gboolean plug_removed_cb(GtkSocket *socket, gpointer data) {
+    ContainerData *cd = (ContainerData*)data;
+
+    if(cd->plug) {
+    	g_hash_table_remove(tabster.plugs, GUINT_TO_POINTER(cd->plug));
+    	cd->plug = 0;
+    }
+
+    // keep default behaviour, the socket gets destroyed
+    return FALSE;
 }
-gint by_widget(gconstpointer data, gconstpointer widget) {
-	return ((ContainerData*)data)->socket==(GtkWidget*)widget ? 0 : 1;
+
+GdkFilterReturn xevent_filter_cb(GdkXEvent *xevent, GdkEvent *event, gpointer data) {
+    XEvent *xev = (XEvent*)xevent;
+    ContainerData *cd;
+
+    if(xev->type != PropertyNotify)
+    	return GDK_FILTER_CONTINUE;
+    if(xev->xproperty.atom != tabster.atom_net_wm_name && xev->xproperty.atom != XA_WM_NAME)
+    	return GDK_FILTER_CONTINUE;
+
+    cd = g_hash_table_lookup(tabster.plugs, GUINT_TO_POINTER(xev->xproperty.window));
+    if(cd)
+    	queue_title_update(cd);
+
+    return GDK_FILTER_CONTINUE;
 }
-gint by_path(gconstpointer data, gconstpointer path) {
-	gint r;
-	GtkTreePath *p;
 
-	p = gtk_tree_row_reference_get_path(((ContainerData*)data)->row); // FREE_by_path_p
-	r = !gtk_tree_path_compare(path, p) ? 0 : 1;
-    gtk_tree_path_free(p); // FREED_by_path_p
-    return r;
+void title_cell_cb(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model, GtkTreeIter *iter, gpointer data) {
+    ContainerData *cd;
+
+	gtk_tree_model_get(model, iter, 0, &cd, -1);
+	g_object_set(renderer, "text", cd && cd->title ? cd->title : "", NULL);
 }
 
 void save_session() {
 	int sessionfd;
 	char *s, *sessionfn;
-	gchar *paths;
-	gint page = 0;
-	ContainerData *cd = NULL;
-	GtkTreePath *path;
+
+	if(tabster.batching) {
+		tabster.dirty |= DIRTY_SESSION;
+		return;
+	}
 
 	s = getenv("XDG_DATA_HOME");
 	if(s)
@@ -606,22 +1228,156 @@ void save_session() {
 	sessionfd = open(sessionfn, O_WRONLY|O_CREAT|O_TRUNC);
     fchmod(sessionfd, 0666);
 
-	for(page = 0; page>=0; page=linear_step(STEP_NEXT, page, FALSE)) {
-		cd = get_cd_by(NTH_PAGE(page));
-		if(cd) {
-			path = gtk_tree_row_reference_get_path(cd->row);
-			paths = gtk_tree_path_to_string(path);
-			write(sessionfd, "add ", 4);
-			write(sessionfd, paths, strlen(paths));
-			g_free(paths);
-			write(sessionfd, " ", 1);
-			write(sessionfd, cd->restore_cmd, strlen(cd->restore_cmd));
-			write(sessionfd, "\n", 1);
-			gtk_tree_path_free(path);
+	if(tabtree_serialize(&tabster.tree, save_tab_cb, &sessionfd))
+		fprintf(stderr, "session: tree too deep, deeper tabs not saved\n");
+
+    close(sessionfd);
+    g_free(sessionfn);
+}
+
+void save_tab_cb(TabTree *t, int n, const char *path, void *data) {
+	int sessionfd = *(int*)data;
+	ContainerData *cd = (ContainerData*)TABTREE_DATA(t, n);
+
+	write(sessionfd, "add ", 4);
+	write(sessionfd, path, strlen(path));
+	write(sessionfd, " ", 1);
+	if(cd->restore_cmd)
+		write(sessionfd, cd->restore_cmd, strlen(cd->restore_cmd));
+	write(sessionfd, "\n", 1);
+}
+
+void open_status(int pid) {
+	const char *dir;
+
+	dir = getenv("XDG_RUNTIME_DIR");
+	tabster.statusfn = g_strdup_printf("%s/tabster%d.status", dir ? dir : "/tmp", pid); // FREE close_status/statusfn
+	tabster.status_size = sysconf(_SC_PAGESIZE);
+
+	// the name is predictable in /tmp: never follow or reuse what is there, titles are private
+	unlink(tabster.statusfn);
+	tabster.statusfd = open(tabster.statusfn, O_RDWR|O_CREAT|O_EXCL|O_NOFOLLOW, 0600); // FREE close_status/statusfd
+	if(tabster.statusfd<0 || ftruncate(tabster.statusfd, tabster.status_size)) {
+		perror("status page");
+		close_status();
+		return;
+	}
+	tabster.status = mmap(NULL, tabster.status_size, PROT_READ|PROT_WRITE, MAP_SHARED, tabster.statusfd, 0); // FREE close_status/status
+	if(tabster.status==MAP_FAILED) {
+		perror("status page");
+		tabster.status = NULL;
+		close_status();
+		return;
+	}
+
+	tabster.status->magic = TABSTER_STATUS_MAGIC;
+	tabster.status->version = TABSTER_STATUS_VERSION;
+	tabster.status->current = -1;
+	tabster.status->size = tabster.status_size;
+}
+
+void close_status() {
+	if(tabster.status_idle)
+		g_source_remove(tabster.status_idle);
+	tabster.status_idle = 0;
+	if(tabster.status)
+		munmap(tabster.status, tabster.status_size); // FREED close_status/status
+	tabster.status = NULL;
+	if(tabster.statusfd>=0)
+		close(tabster.statusfd); // FREED close_status/statusfd
+	tabster.statusfd = -1;
+	if(tabster.statusfn) {
+		unlink(tabster.statusfn);
+		g_free(tabster.statusfn); // FREED close_status/statusfn
+	}
+	tabster.statusfn = NULL;
+}
+
+void status_changed() {
+	// publish once after the current batch of changes
+	if(tabster.status && !tabster.status_idle)
+		tabster.status_idle = g_idle_add(publish_status_cb, NULL);
+}
+
+gboolean publish_status_cb(gpointer data) {
+	tabster.status_idle = 0;
+	publish_status();
+	return FALSE;
+}
+
+void publish_status() {
+	ContainerData *cd;
+	TabsterStatus *st;
+	TabsterStatusTab *tab;
+	gsize need, off, len;
+	gint cur;
+	int n;
+	guint32 seq, i;
+
+	if(!tabster.status)
+		return;
+
+	need = sizeof(TabsterStatus) + tabster.tree.count * sizeof(TabsterStatusTab);
+	for(n = tabtree_first(&tabster.tree); n!=TABTREE_NONE; n = tabtree_next(&tabster.tree, n)) {
+		cd = (ContainerData*)TABTREE_DATA(&tabster.tree, n);
+		need += cd->title ? strlen(cd->title) + 1 : 0;
+	}
+
+	// grow the file, readers remap when they see the new size
+	if(need>tabster.status_size) {
+		len = tabster.status_size;
+		while(len<need)
+			len *= 2;
+		munmap(tabster.status, tabster.status_size);
+		tabster.status = NULL;
+		if(ftruncate(tabster.statusfd, len) ||
+			(tabster.status = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, tabster.statusfd, 0))==MAP_FAILED) {
+			perror("status page");
+			tabster.status = NULL;
+			close_status();
+			return;
+		}
+		tabster.status_size = len;
+	}
+	st = tabster.status;
+
+	// seqlock: odd while writing
+	seq = st->seq;
+	__atomic_store_n(&st->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	st->size = tabster.status_size;
+	st->count = tabster.tree.count;
+	st->current = -1;
+	st->strings = sizeof(TabsterStatus) + tabster.tree.count * sizeof(TabsterStatusTab);
+
+	cur = CURPAGE;
+	off = st->strings;
+	// tabs in tree order
+	for(i = 0, n = tabtree_first(&tabster.tree); n!=TABTREE_NONE; i++, n = tabtree_next(&tabster.tree, n)) {
+		cd = (ContainerData*)TABTREE_DATA(&tabster.tree, n);
+		tab = &st->tabs[i];
+
+		tab->pid = cd->pid;
+		// the notebook follows the tree, asking it is O(n) per tab
+		tab->page = i;
+		if((gint)i==cur)
+			st->current = i;
+		tab->depth = tabtree_depth(&tabster.tree, n);
+
+		if(cd->title) {
+			len = strlen(cd->title);
+			memcpy((char*)st + off, cd->title, len + 1);
+			tab->title = off;
+			tab->title_len = len;
+			off += len + 1;
+		} else {
+			tab->title = 0;
+			tab->title_len = 0;
 		}
 	}
 
-    close(sessionfd);
+	__atomic_store_n(&st->seq, seq + 2, __ATOMIC_RELEASE);
 }
 
 int main(int argc, char **argv) {
@@ -644,6 +1400,14 @@ int main(int argc, char **argv) {
 		&version,
 		"Print version information",
 		NULL
+	}, {
+		"spawns",
+		'j',
+		0,
+		G_OPTION_ARG_INT,
+		&max_spawns,
+		"Number of clients started at once, 0 for no limit",
+		"N"
 	}, {
 		NULL
 	} };
@@ -661,6 +1425,11 @@ int main(int argc, char **argv) {
 
 	setup_window();
 
+	tabtree_init(&tabster.tree); // FREE main/tabster.tree
+	tabster.strpool = g_hash_table_new(g_str_hash, g_str_equal); // FREE main/tabster.strpool
+	tabster.statusfd = -1;
+	open_status(pid); // FREE main/status
+
     mkfifo(fdfn, 0766); // FREE main/fifo
     tabster.fifofd = open(fdfn, O_NONBLOCK); // FREE main/tabster.fifofd
 
@@ -674,6 +1443,10 @@ int main(int argc, char **argv) {
     unlink(fdfn); // FREED main/fifo
     g_free(fdfn); // FREED main/fdfn
 	g_free(env_pid); // FREED main/env_pid
+	close_status(); // FREED main/status
+	g_hash_table_destroy(tabster.strpool); // FREED main/tabster.strpool
+	g_hash_table_destroy(tabster.plugs); // FREED main/tabster.plugs
+	tabtree_free(&tabster.tree); // FREED main/tabster.tree
 
 	return EXIT_SUCCESS;
 }
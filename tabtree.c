@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2014 Stefan Mark <mark at unserver dot de>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tabtree.h"
+
+#define NODE(n) (t->nodes[n])
+
+static int grow(TabTree *t);
+static void link_node(TabTree *t, int n, int parent, int before);
+static void unlink_node(TabTree *t, int n);
+static int serialize(TabTree *t, int parent, char *path, size_t off, TabTreeVisitFunc func, void *data);
+
+void tabtree_init(TabTree *t) {
+	t->nodes = NULL;
+	t->size = 0;
+	t->count = 0;
+	t->free = TABTREE_NONE;
+	t->first = TABTREE_NONE;
+	t->last = TABTREE_NONE;
+}
+
+void tabtree_free(TabTree *t) {
+	free(t->nodes); // FREED tabtree_insert/t->nodes
+	tabtree_init(t);
+}
+
+int grow(TabTree *t) {
+	TabNode *nodes;
+	int i, size;
+
+	size = t->size ? t->size * 2 : 16;
+	if((nodes = realloc(t->nodes, size * sizeof(TabNode))) == NULL) // FREE tabtree_free/t->nodes
+		return -1;
+
+	// chain the new nodes into the free list
+	for(i = t->size; i<size; i++)
+		nodes[i].next = i + 1<size ? i + 1 : t->free;
+	t->free = t->size;
+	t->nodes = nodes;
+	t->size = size;
+
+	return 0;
+}
+
+// put n into the children of parent, before sibling before or at the end
+void link_node(TabTree *t, int n, int parent, int before) {
+	int *first = parent==TABTREE_NONE ? &t->first : &NODE(parent).first_child;
+	int *last = parent==TABTREE_NONE ? &t->last : &NODE(parent).last_child;
+
+	NODE(n).parent = parent;
+	NODE(n).next = before;
+	if(before==TABTREE_NONE) {
+		NODE(n).prev = *last;
+		*last = n;
+	} else {
+		NODE(n).prev = NODE(before).prev;
+		NODE(before).prev = n;
+	}
+	if(NODE(n).prev==TABTREE_NONE)
+		*first = n;
+	else
+		NODE(NODE(n).prev).next = n;
+}
+
+// take n out of the children of its parent, its own children stay
+void unlink_node(TabTree *t, int n) {
+	int parent = NODE(n).parent;
+
+	if(NODE(n).prev==TABTREE_NONE) {
+		if(parent==TABTREE_NONE)
+			t->first = NODE(n).next;
+		else
+			NODE(parent).first_child = NODE(n).next;
+	} else {
+		NODE(NODE(n).prev).next = NODE(n).next;
+	}
+
+	if(NODE(n).next==TABTREE_NONE) {
+		if(parent==TABTREE_NONE)
+			t->last = NODE(n).prev;
+		else
+			NODE(parent).last_child = NODE(n).prev;
+	} else {
+		NODE(NODE(n).next).prev = NODE(n).prev;
+	}
+}
+
+int tabtree_insert(TabTree *t, int parent, int before, void *data) {
+	int n;
+
+	if(t->free==TABTREE_NONE && grow(t))
+		return TABTREE_NONE;
+
+	n = t->free;
+	t->free = NODE(n).next;
+	t->count++;
+
+	NODE(n).first_child = TABTREE_NONE;
+	NODE(n).last_child = TABTREE_NONE;
+	NODE(n).data = data;
+	link_node(t, n, parent, before);
+
+	return n;
+}
+
+void tabtree_remove(TabTree *t, int n) {
+	int c, next;
+
+	// children take the place of n, in order
+	for(c = NODE(n).first_child; c!=TABTREE_NONE; c = next) {
+		next = NODE(c).next;
+		link_node(t, c, NODE(n).parent, n);
+	}
+	unlink_node(t, n);
+
+	NODE(n).data = NULL;
+	NODE(n).next = t->free;
+	t->free = n;
+	t->count--;
+}
+
+int tabtree_reparent(TabTree *t, int n, int parent, int before) {
+	if(parent==n || before==n || (parent!=TABTREE_NONE && tabtree_is_ancestor(t, n, parent)))
+		return -1;
+	// before has to be a sibling under parent
+	if(before!=TABTREE_NONE && NODE(before).parent!=parent)
+		return -1;
+
+	unlink_node(t, n);
+	link_node(t, n, parent, before);
+
+	return 0;
+}
+
+// is a an ancestor of n
+int tabtree_is_ancestor(TabTree *t, int a, int n) {
+	for(n = NODE(n).parent; n!=TABTREE_NONE; n = NODE(n).parent)
+		if(n==a)
+			return 1;
+	return 0;
+}
+
+int tabtree_first(TabTree *t) {
+	return t->first;
+}
+
+int tabtree_last(TabTree *t) {
+	int n = t->last;
+
+	while(n!=TABTREE_NONE && NODE(n).last_child!=TABTREE_NONE)
+		n = NODE(n).last_child;
+	return n;
+}
+
+int tabtree_next(TabTree *t, int n) {
+	if(NODE(n).first_child!=TABTREE_NONE)
+		return NODE(n).first_child;
+
+	// no children, next sibling of n or of the closest ancestor having one
+	for(; n!=TABTREE_NONE; n = NODE(n).parent)
+		if(NODE(n).next!=TABTREE_NONE)
+			return NODE(n).next;
+	return TABTREE_NONE;
+}
+
+int tabtree_prev(TabTree *t, int n) {
+	if(NODE(n).prev==TABTREE_NONE)
+		return NODE(n).parent;
+
+	// deepest last child of the previous sibling
+	for(n = NODE(n).prev; NODE(n).last_child!=TABTREE_NONE; n = NODE(n).last_child);
+	return n;
+}
+
+int tabtree_depth(TabTree *t, int n) {
+	int d;
+
+	for(d = 0; n!=TABTREE_NONE; n = NODE(n).parent)
+		d++;
+	return d;
+}
+
+int tabtree_nth_child(TabTree *t, int parent, int i) {
+	int c;
+
+	c = parent==TABTREE_NONE ? t->first : NODE(parent).first_child;
+	for(; c!=TABTREE_NONE && i>0; i--)
+		c = NODE(c).next;
+	return c;
+}
+
+// write the path of n to buf, returns the length it needs like snprintf
+int tabtree_path(TabTree *t, int n, char *buf, size_t len) {
+	int i, c, r;
+
+	if(n==TABTREE_NONE) {
+		if(len)
+			*buf = '\0';
+		return 0;
+	}
+
+	for(i = 0, c = NODE(n).prev; c!=TABTREE_NONE; c = NODE(c).prev)
+		i++;
+
+	r = tabtree_path(t, NODE(n).parent, buf, len);
+	if((size_t)r<len)
+		r += snprintf(buf + r, len - r, r ? ":%d" : "%d", i);
+	else
+		r += snprintf(NULL, 0, r ? ":%d" : "%d", i);
+	return r;
+}
+
+int tabtree_lookup(TabTree *t, const char *path) {
+	int n = TABTREE_NONE;
+	long i;
+	char *end;
+
+	do {
+		// strtol would take leading space and a sign
+		if(!isdigit((unsigned char)*path))
+			return TABTREE_NONE;
+		i = strtol(path, &end, 10);
+		if(end==path || i<0 || i>INT_MAX)
+			return TABTREE_NONE;
+		if((n = tabtree_nth_child(t, n, i))==TABTREE_NONE)
+			return TABTREE_NONE;
+		path = end + 1;
+	} while(*end==':');
+
+	return *end ? TABTREE_NONE : n;
+}
+
+int serialize(TabTree *t, int parent, char *path, size_t off, TabTreeVisitFunc func, void *data) {
+	int c, i, l;
+
+	c = parent==TABTREE_NONE ? t->first : NODE(parent).first_child;
+	for(i = 0; c!=TABTREE_NONE; c = NODE(c).next, i++) {
+		l = snprintf(path + off, TABTREE_PATH_MAX - off, off ? ":%d" : "%d", i);
+		if(off + l>=TABTREE_PATH_MAX)
+			return -1;
+		func(t, c, path, data);
+		if(serialize(t, c, path, off + l, func, data))
+			return -1;
+	}
+
+	return 0;
+}
+
+// call func for every node in pre-order, returns -1 if a path got too long
+int tabtree_serialize(TabTree *t, TabTreeVisitFunc func, void *data) {
+	char path[TABTREE_PATH_MAX];
+
+	return serialize(t, TABTREE_NONE, path, 0, func, data);
+}
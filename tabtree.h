@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2014 Stefan Mark <mark at unserver dot de>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The tab tree, without any GTK.
+ *
+ * Nodes live in one array and refer to each other by index, removed nodes
+ * are reused. A node index stays valid until the node is removed. Paths
+ * are the same as GtkTreePath strings: "0:2:1" is the second child of the
+ * third child of the first top level node.
+ */
+
+#ifndef TABTREE_H
+#define TABTREE_H
+
+#include <stddef.h>
+
+#define TABTREE_NONE (-1)
+#define TABTREE_PATH_MAX 4096
+
+#define TABTREE_DATA(t, n) ((t)->nodes[n].data)
+#define TABTREE_PARENT(t, n) ((t)->nodes[n].parent)
+#define TABTREE_FIRST_CHILD(t, n) ((t)->nodes[n].first_child)
+#define TABTREE_LAST_CHILD(t, n) ((t)->nodes[n].last_child)
+#define TABTREE_NEXT_SIBLING(t, n) ((t)->nodes[n].next)
+#define TABTREE_PREV_SIBLING(t, n) ((t)->nodes[n].prev)
+
+struct TabNode_ {
+	int parent;
+	int first_child;
+	int last_child;
+	int prev; // previous sibling
+	int next; // next sibling, next free node if unused
+	void *data;
+} typedef TabNode;
+
+struct TabTree_ {
+	TabNode *nodes;
+	int size;  // allocated nodes
+	int count; // used nodes
+	int free;  // first unused node
+	int first; // first top level node
+	int last;  // last top level node
+} typedef TabTree;
+
+typedef void (*TabTreeVisitFunc)(TabTree *t, int n, const char *path, void *data);
+
+void tabtree_init(TabTree *t);
+void tabtree_free(TabTree *t);
+
+// structure
+int tabtree_insert(TabTree *t, int parent, int before, void *data);
+void tabtree_remove(TabTree *t, int n);
+int tabtree_reparent(TabTree *t, int n, int parent, int before);
+int tabtree_is_ancestor(TabTree *t, int a, int n);
+
+// pre-order walk
+int tabtree_first(TabTree *t);
+int tabtree_last(TabTree *t);
+int tabtree_next(TabTree *t, int n);
+int tabtree_prev(TabTree *t, int n);
+
+// positions
+int tabtree_depth(TabTree *t, int n);
+int tabtree_nth_child(TabTree *t, int parent, int i);
+int tabtree_path(TabTree *t, int n, char *buf, size_t len);
+int tabtree_lookup(TabTree *t, const char *path);
+
+// pre-order walk with paths, cheaper than tabtree_path for every node
+int tabtree_serialize(TabTree *t, TabTreeVisitFunc func, void *data);
+
+#endif
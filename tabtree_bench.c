@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2014 Stefan Mark <mark at unserver dot de>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tabtree.h"
+
+static double now();
+static void build(TabTree *t, int count);
+static void bench(int count);
+static void visit_cb(TabTree *t, int n, const char *path, void *data);
+
+static volatile int sink;
+
+double now() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// tabs opened like a user does: mostly children of a recent tab
+void build(TabTree *t, int count) {
+	int i, n = TABTREE_NONE;
+
+	for(i = 0; i<count; i++) {
+		if(n==TABTREE_NONE || rand() % 4==0)
+			n = tabtree_insert(t, TABTREE_NONE, TABTREE_NONE, NULL);
+		else if(rand() % 2)
+			n = tabtree_insert(t, n, TABTREE_NONE, NULL);
+		else
+			n = tabtree_insert(t, TABTREE_PARENT(t, n), TABTREE_NONE, NULL);
+	}
+}
+
+void visit_cb(TabTree *t, int n, const char *path, void *data) {
+	*(int*)data += *path;
+}
+
+void bench(int count) {
+	TabTree t;
+	double start, insert, walk, path, lookup, remove;
+	int i, n, r = 0;
+
+	srand(count);
+	tabtree_init(&t);
+
+	start = now();
+	build(&t, count);
+	insert = now() - start;
+
+	start = now();
+	for(i = 0; i<100; i++)
+		for(n = tabtree_first(&t); n!=TABTREE_NONE; n = tabtree_next(&t, n))
+			r++;
+	walk = (now() - start) / 100;
+
+	// serialize, as save_session does
+	start = now();
+	tabtree_serialize(&t, visit_cb, &r);
+	path = now() - start;
+
+	start = now();
+	for(i = 0; i<count; i++)
+		r += tabtree_lookup(&t, "0:0");
+	lookup = now() - start;
+
+	start = now();
+	while((n = tabtree_first(&t))!=TABTREE_NONE)
+		tabtree_remove(&t, n);
+	remove = now() - start;
+
+	sink = r;
+	tabtree_free(&t);
+
+	printf("%7d tabs: insert %6.1f  walk %6.1f  serialize %6.1f  lookup %6.1f  remove %6.1f ns/tab\n",
+		count, insert / count, walk / count, path / count, lookup / count, remove / count);
+}
+
+int main(int argc, char **argv) {
+	int count;
+
+	for(count = 10; count<=100000; count *= 10)
+		bench(count);
+
+	return EXIT_SUCCESS;
+}
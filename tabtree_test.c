@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2014 Stefan Mark <mark at unserver dot de>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF MIND, USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING
+ * OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tabtree.h"
+
+#define CHECK(cond) check(cond, #cond, __LINE__)
+
+static int failed = 0;
+
+static void check(int ok, const char *what, int line);
+static void dump(TabTree *t, char *buf, size_t len);
+
+static void test_insert();
+static void test_remove();
+static void test_reparent();
+static void test_walk();
+static void test_path();
+static void test_reuse();
+static void test_serialize();
+static void serialize_cb(TabTree *t, int n, const char *path, void *data);
+static void count_cb(TabTree *t, int n, const char *path, void *data);
+
+void check(int ok, const char *what, int line) {
+	if(!ok) {
+		fprintf(stderr, "tabtree_test.c:%d: %s\n", line, what);
+		failed++;
+	}
+}
+
+// pre-order walk as "path=name" list, names are the node data
+void dump(TabTree *t, char *buf, size_t len) {
+	int n;
+	size_t l = 0;
+	char path[64];
+
+	*buf = '\0';
+	for(n = tabtree_first(t); n!=TABTREE_NONE; n = tabtree_next(t, n)) {
+		tabtree_path(t, n, path, sizeof(path));
+		l += snprintf(buf + l, len - l, "%s%s=%s", l ? " " : "", path, (char*)TABTREE_DATA(t, n));
+	}
+}
+
+void test_insert() {
+	TabTree t;
+	char buf[256];
+	int a, b, c, d;
+
+	tabtree_init(&t);
+	a = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "a");
+	b = tabtree_insert(&t, a, TABTREE_NONE, "b");
+	c = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "c");
+	d = tabtree_insert(&t, TABTREE_NONE, c, "d");
+
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=a 0:0=b 1=d 2=c"));
+	CHECK(t.count==4);
+	CHECK(TABTREE_PARENT(&t, b)==a);
+	CHECK(TABTREE_PARENT(&t, d)==TABTREE_NONE);
+
+	tabtree_free(&t);
+}
+
+void test_remove() {
+	TabTree t;
+	char buf[256];
+	int a, b;
+
+	tabtree_init(&t);
+	a = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "a");
+	b = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "b");
+	tabtree_insert(&t, b, TABTREE_NONE, "c");
+	tabtree_insert(&t, tabtree_insert(&t, b, TABTREE_NONE, "d"), TABTREE_NONE, "e");
+	tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "f");
+
+	// children move up in place of the removed node, in order
+	tabtree_remove(&t, b);
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=a 1=c 2=d 2:0=e 3=f"));
+
+	tabtree_remove(&t, a);
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=c 1=d 1:0=e 2=f"));
+
+	tabtree_remove(&t, tabtree_last(&t));
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=c 1=d 1:0=e"));
+	CHECK(t.count==3);
+
+	tabtree_free(&t);
+}
+
+void test_reparent() {
+	TabTree t;
+	char buf[256];
+	int a, b, c;
+
+	tabtree_init(&t);
+	a = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "a");
+	b = tabtree_insert(&t, a, TABTREE_NONE, "b");
+	c = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "c");
+
+	// subtree moves along
+	CHECK(!tabtree_reparent(&t, a, c, TABTREE_NONE));
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=c 0:0=a 0:0:0=b"));
+
+	// no cycles
+	CHECK(tabtree_reparent(&t, c, b, TABTREE_NONE));
+	CHECK(tabtree_reparent(&t, a, a, TABTREE_NONE));
+	// before not under parent
+	CHECK(tabtree_reparent(&t, b, TABTREE_NONE, a));
+	CHECK(tabtree_reparent(&t, a, TABTREE_NONE, b));
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=c 0:0=a 0:0:0=b"));
+
+	CHECK(!tabtree_reparent(&t, b, TABTREE_NONE, c));
+	dump(&t, buf, sizeof(buf));
+	CHECK(!strcmp(buf, "0=b 1=c 1:0=a"));
+	CHECK(tabtree_is_ancestor(&t, c, a));
+	CHECK(!tabtree_is_ancestor(&t, a, c));
+
+	tabtree_free(&t);
+}
+
+void test_walk() {
+	TabTree t;
+	int n, i, nodes[6];
+
+	tabtree_init(&t);
+	CHECK(tabtree_first(&t)==TABTREE_NONE);
+	CHECK(tabtree_last(&t)==TABTREE_NONE);
+
+	// 0, 0:0, 0:0:0, 0:1, 1, 1:0
+	nodes[0] = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, NULL);
+	nodes[1] = tabtree_insert(&t, nodes[0], TABTREE_NONE, NULL);
+	nodes[2] = tabtree_insert(&t, nodes[1], TABTREE_NONE, NULL);
+	nodes[3] = tabtree_insert(&t, nodes[0], TABTREE_NONE, NULL);
+	nodes[4] = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, NULL);
+	nodes[5] = tabtree_insert(&t, nodes[4], TABTREE_NONE, NULL);
+
+	for(i = 0, n = tabtree_first(&t); n!=TABTREE_NONE; n = tabtree_next(&t, n), i++)
+		CHECK(i<6 && n==nodes[i]);
+	CHECK(i==6);
+
+	for(i = 5, n = tabtree_last(&t); n!=TABTREE_NONE; n = tabtree_prev(&t, n), i--)
+		CHECK(i>=0 && n==nodes[i]);
+	CHECK(i==-1);
+
+	CHECK(tabtree_depth(&t, nodes[0])==1);
+	CHECK(tabtree_depth(&t, nodes[2])==3);
+
+	tabtree_free(&t);
+}
+
+void test_path() {
+	TabTree t;
+	char buf[8];
+	int a, b, c;
+
+	tabtree_init(&t);
+	a = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, NULL);
+	tabtree_insert(&t, a, TABTREE_NONE, NULL);
+	b = tabtree_insert(&t, a, TABTREE_NONE, NULL);
+	c = tabtree_insert(&t, b, TABTREE_NONE, NULL);
+
+	CHECK(tabtree_path(&t, c, buf, sizeof(buf))==5);
+	CHECK(!strcmp(buf, "0:1:0"));
+	// truncates like snprintf
+	CHECK(tabtree_path(&t, c, buf, 3)==5);
+	CHECK(!strcmp(buf, "0:"));
+
+	CHECK(tabtree_lookup(&t, "0")==a);
+	CHECK(tabtree_lookup(&t, "0:1")==b);
+	CHECK(tabtree_lookup(&t, "0:1:0")==c);
+	CHECK(tabtree_lookup(&t, "1")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "0:2")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "0:")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "0x")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "-1")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "4294967296")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "+0")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, " 0")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "0: 1")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "0:+1")==TABTREE_NONE);
+	CHECK(tabtree_lookup(&t, "0:4294967297")==TABTREE_NONE);
+
+	tabtree_free(&t);
+}
+
+void test_reuse() {
+	TabTree t;
+	int i, n, size;
+
+	tabtree_init(&t);
+	for(i = 0; i<100; i++)
+		tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, NULL);
+	size = t.size;
+
+	// removed nodes are taken again before the array grows
+	for(i = 0; i<1000; i++) {
+		n = tabtree_nth_child(&t, TABTREE_NONE, i % 50);
+		tabtree_remove(&t, n);
+		tabtree_insert(&t, tabtree_first(&t), TABTREE_NONE, NULL);
+	}
+	CHECK(t.count==100);
+	CHECK(t.size==size);
+
+	for(i = 0, n = tabtree_first(&t); n!=TABTREE_NONE; n = tabtree_next(&t, n))
+		i++;
+	CHECK(i==100);
+
+	tabtree_free(&t);
+}
+
+void serialize_cb(TabTree *t, int n, const char *path, void *data) {
+	char *buf = (char*)data;
+	char p[64];
+
+	// same paths as tabtree_path
+	tabtree_path(t, n, p, sizeof(p));
+	CHECK(!strcmp(p, path));
+
+	if(*buf)
+		strcat(buf, " ");
+	strcat(buf, path);
+	strcat(buf, "=");
+	strcat(buf, (char*)TABTREE_DATA(t, n));
+}
+
+void count_cb(TabTree *t, int n, const char *path, void *data) {
+	(*(int*)data)++;
+}
+
+void test_serialize() {
+	TabTree t;
+	char buf[256], walk[256];
+	int a, b, i;
+
+	tabtree_init(&t);
+	a = tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "a");
+	b = tabtree_insert(&t, a, TABTREE_NONE, "b");
+	tabtree_insert(&t, b, TABTREE_NONE, "c");
+	tabtree_insert(&t, a, TABTREE_NONE, "d");
+	tabtree_insert(&t, TABTREE_NONE, TABTREE_NONE, "e");
+
+	*buf = '\0';
+	CHECK(!tabtree_serialize(&t, serialize_cb, buf));
+	dump(&t, walk, sizeof(walk));
+	CHECK(!strcmp(buf, walk));
+	CHECK(!strcmp(buf, "0=a 0:0=b 0:0:0=c 0:1=d 1=e"));
+	tabtree_free(&t);
+
+	// too deep for a path
+	tabtree_init(&t);
+	for(i = 0, b = TABTREE_NONE; i<TABTREE_PATH_MAX; i++)
+		b = tabtree_insert(&t, b, TABTREE_NONE, "x");
+	i = 0;
+	CHECK(tabtree_serialize(&t, count_cb, &i)==-1);
+	CHECK(i==TABTREE_PATH_MAX / 2);
+	tabtree_free(&t);
+}
+
+int main(int argc, char **argv) {
+	test_insert();
+	test_remove();
+	test_reparent();
+	test_walk();
+	test_path();
+	test_reuse();
+	test_serialize();
+
+	if(failed) {
+		fprintf(stderr, "%d checks failed\n", failed);
+		return EXIT_FAILURE;
+	}
+	printf("tabtree: all tests passed\n");
+	return EXIT_SUCCESS;
+}